@@ -0,0 +1,129 @@
+#ifndef VVENGINE_C_API_H_
+#define VVENGINE_C_API_H_
+
+/*
+ * Stable C interface of libvvengine_c, for embedding from other languages.
+ * All strings are UTF-8. Audio is mono float32 at vv_sampling_rate().
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#ifdef VVENGINE_C_EXPORTS
+#define VV_API __declspec(dllexport)
+#else
+#define VV_API __declspec(dllimport)
+#endif
+#else
+#define VV_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct vv_engine vv_engine;
+/* Audio owned by the library; valid until vv_buffer_release(). */
+typedef struct vv_buffer vv_buffer;
+
+typedef enum vv_status {
+  VV_OK = 0,
+  VV_ERROR_INVALID_ARGUMENT,
+  VV_ERROR_NOT_INITIALIZED,
+  VV_ERROR_SYNTHESIS_FAILED,
+  VV_ERROR_BUFFER_TOO_SMALL,
+  VV_ERROR_CANCELLED,
+} vv_status;
+
+typedef enum vv_normalization {
+  VV_NORMALIZATION_NONE = 0,
+  VV_NORMALIZATION_PEAK,
+  VV_NORMALIZATION_RMS,
+  VV_NORMALIZATION_LOUDNESS,
+} vv_normalization;
+
+/*
+ * Mirrors vvengine::SynthesisOptions. Fill with vv_synthesis_options_init().
+ * New fields are only ever appended; `struct_size` tells the library which of
+ * them the caller knows about, and the others keep their defaults.
+ */
+typedef struct vv_synthesis_options {
+  size_t struct_size; /* sizeof(vv_synthesis_options) as the caller sees it */
+  float pre_phoneme_length;
+  float post_phoneme_length;
+  float volume_scale;
+  int normalization; /* vv_normalization */
+  float target_level;
+  int trim_silence;
+  float trim_threshold_db;
+  float pre_pause_length;
+  float post_pause_length;
+  /* prosody edits */
+  float speed_scale;
+  float pitch_scale;
+  float intonation_scale;
+} vv_synthesis_options;
+
+/*
+ * Receives consecutive pieces of the audio. `samples` is only valid during the
+ * call. Return non-zero to stop; the synthesis call then reports
+ * VV_ERROR_CANCELLED.
+ */
+typedef int (*vv_chunk_callback)(const float* samples, size_t length,
+                                 void* user_data);
+
+VV_API int vv_sampling_rate(void);
+/* Writes the defaults into the first `struct_size` bytes of `options`. */
+VV_API void vv_synthesis_options_init(vv_synthesis_options* options,
+                                      size_t struct_size);
+#define VV_SYNTHESIS_OPTIONS_INIT(options) \
+  vv_synthesis_options_init((options), sizeof(vv_synthesis_options))
+
+VV_API vv_engine* vv_engine_create(void);
+VV_API void vv_engine_destroy(vv_engine* engine);
+VV_API vv_status vv_engine_initialize(vv_engine* engine, int use_cuda);
+VV_API vv_status vv_engine_reload_user_dictionary(vv_engine* engine,
+                                                  const char* user_dic_path);
+
+/*
+ * `options` may be NULL for the defaults; otherwise `struct_size` must be set
+ * (VV_ERROR_INVALID_ARGUMENT if it is too small).
+ *
+ * vv_engine_synthesize hands the engine's own buffer to the caller: no copy.
+ *
+ * vv_engine_synthesize_into copies the audio once into caller-owned memory.
+ * If `capacity` is too small (or `samples` is NULL), nothing is written,
+ * *length is set to the required size and VV_ERROR_BUFFER_TOO_SMALL is
+ * returned; the audio is discarded. When the size is not known up front, use
+ * vv_engine_synthesize, vv_buffer_length and vv_buffer_copy instead.
+ *
+ * vv_engine_synthesize_stream passes the audio to `callback` in pieces of at
+ * most `chunk_length` samples (0 for a single piece).
+ */
+VV_API vv_status vv_engine_synthesize(vv_engine* engine, const char* text,
+                                      int64_t speaker_id,
+                                      const vv_synthesis_options* options,
+                                      vv_buffer** out);
+VV_API vv_status vv_engine_synthesize_into(vv_engine* engine, const char* text,
+                                           int64_t speaker_id,
+                                           const vv_synthesis_options* options,
+                                           float* samples, size_t capacity,
+                                           size_t* length);
+VV_API vv_status vv_engine_synthesize_stream(
+    vv_engine* engine, const char* text, int64_t speaker_id,
+    const vv_synthesis_options* options, size_t chunk_length,
+    vv_chunk_callback callback, void* user_data);
+
+VV_API const float* vv_buffer_data(const vv_buffer* buffer);
+VV_API size_t vv_buffer_length(const vv_buffer* buffer);
+/* Copies up to `capacity` samples into `samples`; returns how many. */
+VV_API size_t vv_buffer_copy(const vv_buffer* buffer, float* samples,
+                             size_t capacity);
+VV_API void vv_buffer_release(vv_buffer* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VVENGINE_C_API_H_ */
@@ -9,19 +9,71 @@
 #include <string>
 #include <vector>
 
+#include "vvengine/full_context_label.h"
+#include "vvengine/post_processor.h"
+#include "vvengine/timeline.h"
+
 namespace vvengine {
 constexpr const char* kMecabDir = MECAB_DIR;
 constexpr const char* kCoreDir = "./";
+constexpr int kSamplingRate = 24000;
+
+// Text analysis plus the output of the prosody models (yukarin_s, yukarin_sa)
+// for one text and speaker. Synthesize() never modifies it, so speed and pitch
+// edits through SynthesisOptions only rerun frame expansion and the decoder.
+struct AudioQuery {
+  long speakerId;
+  Utterance utterance;
+  std::vector<std::string> phonemes;
+  std::vector<long> phonemeIds;
+  std::vector<float> phonemeLength;  // seconds, as predicted
+  std::vector<int> vowelIndices;     // index into phonemes of each mora vowel
+  std::vector<float> f0List;         // per vowel, 0 if unvoiced
+};
+
+struct SynthesisOptions {
+  float speedScale = 1.0f;       // every phoneme length is divided by this
+  float pitchScale = 0.0f;       // f0 is multiplied by 2^pitchScale
+  float intonationScale = 1.0f;  // scales f0 around its mean over voiced moras
+  // Lengths of the leading and trailing pause phonemes given to the decoder,
+  // in seconds.
+  float prePhonemeLength = 0.1f;
+  float postPhonemeLength = 0.1f;
+  PostProcessOptions postProcess;
+};
 
 class Engine {
  public:
   Engine();
   ~Engine();
 
-  bool Initialize(bool useCUDA);
+  // `userDicPath`, if given, is layered over the system dictionary as in
+  // ReloadUserDictionary; if it fails to load, the engine starts with the
+  // system dictionary alone.
+  bool Initialize(bool useCUDA, const char* userDicPath = nullptr);
   void SetLogger(const std::shared_ptr<std::ostream>& os);
+  // Rebuilds the analysis context with the compiled MeCab user dictionary at
+  // `userDicPath` (nullptr to drop it) and swaps it in atomically. Safe to
+  // call from a background thread while TextToSpeech is running; requests
+  // already running finish on the previous dictionary, which is then freed on
+  // this thread once they have.
+  bool ReloadUserDictionary(const char* userDicPath);
+  // Runs OpenJTalk, yukarin_s and yukarin_sa.
+  bool Analyze(const char* textUtf8, long speakerId, AudioQuery& query);
+  // Applies the prosody edits of `options` to a copy of `query`'s durations
+  // and f0, then decodes. If `timeline` is given, it receives the
+  // phoneme/mora/accent phrase timing of `wave`. Returns false for a query
+  // whose vectors disagree in size or hold out-of-range ids or vowel indices,
+  // or for non-finite options. Negative lengths are treated as 0.
+  bool Synthesize(const AudioQuery& query, std::vector<float>& wave,
+                  const SynthesisOptions& options = SynthesisOptions(),
+                  Timeline* timeline = nullptr);
+  // Analyze() + Synthesize(). Recent analyses are cached per text and
+  // speaker, so repeating a text with other options takes the fast path.
   bool TextToSpeech(const char* textUtf8, long speakerId,
-                    std::vector<float>& wave);
+                    std::vector<float>& wave,
+                    const SynthesisOptions& options = SynthesisOptions(),
+                    Timeline* timeline = nullptr);
 
  protected:
   struct Impl;
@@ -12,6 +12,9 @@ namespace vvengine {
     ~OpenJtalkWrapper();
     bool Initialize();
     bool Load(const char* mecabDir);
+    // Loads `mecabDir` with a compiled user dictionary layered on top.
+    bool Load(const char* mecabDir, const char* userDic);
+    // Thread-safe. Calls are serialized on this instance.
     void ExtractFullContext(const char* text, std::vector<std::string>& labels);
 
     protected:
@@ -0,0 +1,36 @@
+#ifndef VVENGINE_POST_PROCESSOR_H_
+#define VVENGINE_POST_PROCESSOR_H_
+
+#include <vector>
+
+namespace vvengine {
+enum class Normalization {
+  kNone,
+  kPeak,      // sample peak to targetLevel dBFS
+  kRms,       // RMS to targetLevel dBFS
+  kLoudness,  // BS.1770 gated loudness to targetLevel LUFS
+};
+
+struct PostProcessOptions {
+  float volumeScale = 1.0f;
+  Normalization normalization = Normalization::kNone;
+  float targetLevel = -16.0f;
+  // Energy-based trimming. Frames (10 ms) whose RMS stays below
+  // trimThresholdDb are cut from both ends, then prePauseLength and
+  // postPauseLength seconds of silence are put back.
+  bool trimSilence = false;
+  float trimThresholdDb = -50.0f;
+  float prePauseLength = 0.1f;
+  float postPauseLength = 0.1f;
+};
+
+// Applies `options` to `wave` in place. Analysis is one read-only pass over
+// the samples (plus a filter pass for kLoudness); trimming, padding, gain and
+// volume are fused into a single write pass. Fully silent input with
+// trimSilence becomes just the two pauses.
+// Returns how far the kept samples moved, i.e. old index + shift = new index.
+long PostProcess(std::vector<float>& wave, int rate,
+                 const PostProcessOptions& options);
+}  // namespace vvengine
+
+#endif  // VVENGINE_POST_PROCESSOR_H_
@@ -0,0 +1,81 @@
+#ifndef VVENGINE_SUPERVISOR_H_
+#define VVENGINE_SUPERVISOR_H_
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "vvengine/engine.h"
+
+namespace vvengine {
+struct SupervisorOptions {
+  int numWorkers = 2;
+  bool useCUDA = false;
+  // Capacity of each worker's shared-memory audio ring, in samples.
+  size_t ringSamples = 24000 * 4;
+  // A worker that has not finished Engine::Initialize by then is killed.
+  double initTimeoutSeconds = 120;
+  // Retry a request whose worker died while running it on another worker.
+  // Off by default: an input that crashes the models would take that one
+  // down too. Requests that never reached the dead worker are always retried.
+  bool retryCrashedRequests = false;
+};
+
+struct WorkerStats {
+  int pid;
+  long requests;
+  long failures;
+  long restarts;
+  double busySeconds;
+  double utilization;  // busySeconds / uptimeSeconds
+};
+
+struct SupervisorStats {
+  double uptimeSeconds;
+  long requests;
+  double audioSeconds;
+  double requestsPerSecond;
+  double realtimeFactor;  // seconds of audio produced per wall-clock second
+  std::vector<WorkerStats> workers;
+};
+
+// Runs N independent Engines, each in its own forked worker process.
+// VoiceVox Core's `initialize` is process-global, so this is the only way to
+// host several engines (or to survive a crash inside the models) in one
+// service. Requests go to an idle worker over a socketpair and the audio comes
+// back through a shared-memory ring buffer owned by that worker. A worker that
+// dies is restarted in the background (see retryCrashedRequests for what
+// happens to its request).
+// Workers are forked from a single-threaded spawner process that Start()
+// forks, so Start() itself must run before the host spawns other threads.
+// POSIX only.
+class Supervisor {
+ public:
+  Supervisor();
+  ~Supervisor();
+
+  bool Start(const SupervisorOptions& options);
+  void Stop();
+  void SetLogger(const std::shared_ptr<std::ostream>& os);
+  // Thread-safe. Blocks until a worker is free; fails at once if none is
+  // running.
+  bool TextToSpeech(const char* textUtf8, long speakerId,
+                    std::vector<float>& wave,
+                    const SynthesisOptions& options = SynthesisOptions());
+  // Rolling Engine::ReloadUserDictionary over the workers, one at a time;
+  // each keeps serving requests while it loads the dictionary.
+  // If a worker rejects the dictionary, the ones that took it go back to the
+  // previous one and this returns false. Restarted workers load the last
+  // dictionary that every worker accepted.
+  bool ReloadUserDictionary(const char* userDicPath);
+  SupervisorStats Stats() const;
+  void ReportStats(std::ostream& os) const;
+
+ protected:
+  struct Impl;
+  std::unique_ptr<Impl> impl;
+};
+}  // namespace vvengine
+
+#endif  // VVENGINE_SUPERVISOR_H_
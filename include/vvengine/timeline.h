@@ -0,0 +1,65 @@
+#ifndef VVENGINE_TIMELINE_H_
+#define VVENGINE_TIMELINE_H_
+
+#include <string>
+#include <vector>
+
+#include "vvengine/full_context_label.h"
+
+namespace vvengine {
+// Mouth shapes for lip-sync. Consonants without a distinctive shape are
+// kConsonant; clients usually blend them into the following vowel.
+enum class Viseme {
+  kSilence,
+  kA,
+  kI,
+  kU,
+  kE,
+  kO,
+  kClosed,       // m, b, p, N
+  kLabiodental,  // f, v
+  kConsonant,
+};
+
+Viseme VisemeFromPhoneme(const std::string& phoneme);
+const char* VisemeName(Viseme viseme);
+
+// All positions are sample offsets into the returned wave, [start, end).
+struct PhonemeEvent {
+  std::string phoneme;
+  Viseme viseme;
+  long start;
+  long end;
+};
+
+struct MoraEvent {
+  size_t phonemeBegin;  // indices into Timeline::phonemes
+  size_t phonemeEnd;
+  long start;
+  long end;
+};
+
+struct AccentPhraseEvent {
+  size_t moraBegin;  // indices into Timeline::moras
+  size_t moraEnd;
+  int accent;
+  long start;
+  long end;
+};
+
+struct Timeline {
+  std::vector<PhonemeEvent> phonemes;
+  std::vector<MoraEvent> moras;
+  std::vector<AccentPhraseEvent> accentPhrases;
+
+  // `phonemes` and `phonemeSamples` (durations) follow the order of
+  // Utterance::phonemes().
+  static Timeline FromDurations(const Utterance& utterance,
+                                const std::vector<std::string>& phonemes,
+                                const std::vector<long>& phonemeSamples);
+  // Moves every event by `shift` samples and clips it to [0, length].
+  void Shift(long shift, long length);
+};
+}  // namespace vvengine
+
+#endif  // VVENGINE_TIMELINE_H_
@@ -0,0 +1,170 @@
+"""Thin ctypes binding for libvvengine_c.
+
+Audio is returned as a float32 NumPy array that views the engine's buffer
+directly; the buffer is released when the last view of it is collected.
+
+    engine = vvengine.Engine()
+    engine.initialize()
+    wave = engine.synthesize("ハローワールド", speaker_id=0)
+"""
+
+import ctypes
+import ctypes.util
+import os
+import weakref
+
+import numpy as np
+
+VV_OK = 0
+VV_ERROR_BUFFER_TOO_SMALL = 4
+
+NORMALIZATION_NONE = 0
+NORMALIZATION_PEAK = 1
+NORMALIZATION_RMS = 2
+NORMALIZATION_LOUDNESS = 3
+
+
+class SynthesisOptions(ctypes.Structure):
+    _fields_ = [
+        ("struct_size", ctypes.c_size_t),
+        ("pre_phoneme_length", ctypes.c_float),
+        ("post_phoneme_length", ctypes.c_float),
+        ("volume_scale", ctypes.c_float),
+        ("normalization", ctypes.c_int),
+        ("target_level", ctypes.c_float),
+        ("trim_silence", ctypes.c_int),
+        ("trim_threshold_db", ctypes.c_float),
+        ("pre_pause_length", ctypes.c_float),
+        ("post_pause_length", ctypes.c_float),
+        ("speed_scale", ctypes.c_float),
+        ("pitch_scale", ctypes.c_float),
+        ("intonation_scale", ctypes.c_float),
+    ]
+
+
+_CHUNK_CALLBACK = ctypes.CFUNCTYPE(
+    ctypes.c_int, ctypes.POINTER(ctypes.c_float), ctypes.c_size_t,
+    ctypes.c_void_p)
+
+
+def _load_library(path=None):
+    if path is None:
+        path = os.environ.get("VVENGINE_LIBRARY") or \
+            ctypes.util.find_library("vvengine_c") or "libvvengine_c.so"
+    lib = ctypes.CDLL(path)
+
+    engine_p = ctypes.c_void_p
+    buffer_p = ctypes.c_void_p
+    options_p = ctypes.POINTER(SynthesisOptions)
+
+    lib.vv_sampling_rate.restype = ctypes.c_int
+    lib.vv_synthesis_options_init.argtypes = [options_p, ctypes.c_size_t]
+    lib.vv_engine_create.restype = engine_p
+    lib.vv_engine_destroy.argtypes = [engine_p]
+    lib.vv_engine_initialize.argtypes = [engine_p, ctypes.c_int]
+    lib.vv_engine_reload_user_dictionary.argtypes = [engine_p, ctypes.c_char_p]
+    lib.vv_engine_synthesize.argtypes = [
+        engine_p, ctypes.c_char_p, ctypes.c_int64, options_p,
+        ctypes.POINTER(buffer_p)]
+    lib.vv_engine_synthesize_into.argtypes = [
+        engine_p, ctypes.c_char_p, ctypes.c_int64, options_p,
+        ctypes.POINTER(ctypes.c_float), ctypes.c_size_t,
+        ctypes.POINTER(ctypes.c_size_t)]
+    lib.vv_engine_synthesize_stream.argtypes = [
+        engine_p, ctypes.c_char_p, ctypes.c_int64, options_p, ctypes.c_size_t,
+        _CHUNK_CALLBACK, ctypes.c_void_p]
+    lib.vv_buffer_data.restype = ctypes.POINTER(ctypes.c_float)
+    lib.vv_buffer_data.argtypes = [buffer_p]
+    lib.vv_buffer_length.restype = ctypes.c_size_t
+    lib.vv_buffer_length.argtypes = [buffer_p]
+    lib.vv_buffer_copy.restype = ctypes.c_size_t
+    lib.vv_buffer_copy.argtypes = [
+        buffer_p, ctypes.POINTER(ctypes.c_float), ctypes.c_size_t]
+    lib.vv_buffer_release.argtypes = [buffer_p]
+    return lib
+
+
+class VoiceVoxError(RuntimeError):
+    def __init__(self, status):
+        super().__init__("vvengine call failed with status %d" % status)
+        self.status = status
+
+
+def _check(status):
+    if status != VV_OK:
+        raise VoiceVoxError(status)
+
+
+class Engine:
+    def __init__(self, library=None):
+        self._lib = _load_library(library)
+        self._handle = self._lib.vv_engine_create()
+        if not self._handle:
+            raise MemoryError("vv_engine_create failed")
+        self._finalizer = weakref.finalize(
+            self, self._lib.vv_engine_destroy, self._handle)
+        self.sampling_rate = self._lib.vv_sampling_rate()
+
+    def close(self):
+        self._finalizer()
+
+    def default_options(self):
+        options = SynthesisOptions()
+        self._lib.vv_synthesis_options_init(
+            ctypes.byref(options), ctypes.sizeof(options))
+        return options
+
+    def initialize(self, use_cuda=False):
+        _check(self._lib.vv_engine_initialize(self._handle, int(use_cuda)))
+
+    def reload_user_dictionary(self, path=None):
+        _check(self._lib.vv_engine_reload_user_dictionary(
+            self._handle, path.encode() if path else None))
+
+    def synthesize(self, text, speaker_id=0, options=None):
+        """Returns the engine's buffer as a NumPy array, without copying."""
+        buffer = ctypes.c_void_p()
+        _check(self._lib.vv_engine_synthesize(
+            self._handle, text.encode("utf-8"), speaker_id,
+            ctypes.byref(options) if options else None, ctypes.byref(buffer)))
+        length = self._lib.vv_buffer_length(buffer)
+        if length == 0:
+            self._lib.vv_buffer_release(buffer)
+            return np.zeros(0, dtype=np.float32)
+        data = self._lib.vv_buffer_data(buffer)
+        view = (ctypes.c_float * length).from_address(
+            ctypes.addressof(data.contents))
+        weakref.finalize(view, self._lib.vv_buffer_release, buffer)
+        return np.frombuffer(view, dtype=np.float32)
+
+    def synthesize_into(self, out, text, speaker_id=0, options=None):
+        """Writes into the float32 array `out`; returns the sample count.
+
+        If `out` is too small, ValueError tells the required size and the
+        audio is discarded; synthesize() avoids that when the size is not
+        known up front."""
+        if out.dtype != np.float32 or not out.flags.c_contiguous:
+            raise ValueError("out must be a contiguous float32 array")
+        length = ctypes.c_size_t()
+        status = self._lib.vv_engine_synthesize_into(
+            self._handle, text.encode("utf-8"), speaker_id,
+            ctypes.byref(options) if options else None,
+            out.ctypes.data_as(ctypes.POINTER(ctypes.c_float)), out.size,
+            ctypes.byref(length))
+        if status == VV_ERROR_BUFFER_TOO_SMALL:
+            raise ValueError("out needs %d samples" % length.value)
+        _check(status)
+        return length.value
+
+    def synthesize_stream(self, text, on_chunk, speaker_id=0, options=None,
+                          chunk_length=4096):
+        """Calls on_chunk(array) per chunk; the array is only valid inside
+        the call. Return True from on_chunk to stop."""
+        def callback(samples, length, _):
+            chunk = np.ctypeslib.as_array(samples, shape=(length,))
+            return 1 if on_chunk(chunk) else 0
+
+        _check(self._lib.vv_engine_synthesize_stream(
+            self._handle, text.encode("utf-8"), speaker_id,
+            ctypes.byref(options) if options else None, chunk_length,
+            _CHUNK_CALLBACK(callback), None))
@@ -0,0 +1,242 @@
+#include "vvengine/c_api.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "vvengine/engine.h"
+
+struct vv_engine {
+  vvengine::Engine engine;
+  bool initialized = false;
+};
+
+struct vv_buffer {
+  std::vector<float> wave;
+};
+
+namespace {
+// Size of the first published vv_synthesis_options, which ended before the
+// prosody fields; callers built against it must keep working.
+constexpr size_t kMinOptionsSize = offsetof(vv_synthesis_options, speed_scale);
+
+vv_synthesis_options DefaultOptions() {
+  vv_synthesis_options options;
+  std::memset(&options, 0, sizeof(options));
+  const vvengine::SynthesisOptions defaults;
+  const auto& post = defaults.postProcess;
+  options.struct_size = sizeof(options);
+  options.speed_scale = defaults.speedScale;
+  options.pitch_scale = defaults.pitchScale;
+  options.intonation_scale = defaults.intonationScale;
+  options.pre_phoneme_length = defaults.prePhonemeLength;
+  options.post_phoneme_length = defaults.postPhonemeLength;
+  options.volume_scale = post.volumeScale;
+  options.normalization = VV_NORMALIZATION_NONE;
+  options.target_level = post.targetLevel;
+  options.trim_silence = post.trimSilence ? 1 : 0;
+  options.trim_threshold_db = post.trimThresholdDb;
+  options.pre_pause_length = post.prePauseLength;
+  options.post_pause_length = post.postPauseLength;
+  return options;
+}
+
+// Widens the caller's options to this library's layout: fields past its
+// struct_size keep their defaults. Fails if struct_size is too small.
+bool ReadOptions(const vv_synthesis_options* options,
+                 vv_synthesis_options& result) {
+  result = DefaultOptions();
+  if (options == nullptr) return true;
+  if (options->struct_size < kMinOptionsSize) return false;
+  std::memcpy(&result, options,
+              std::min(options->struct_size, sizeof(result)));
+  result.struct_size = sizeof(result);
+  return true;
+}
+
+vvengine::SynthesisOptions ToSynthesisOptions(
+    const vv_synthesis_options* options) {
+  vvengine::SynthesisOptions result;
+  result.speedScale = options->speed_scale;
+  result.pitchScale = options->pitch_scale;
+  result.intonationScale = options->intonation_scale;
+  result.prePhonemeLength = options->pre_phoneme_length;
+  result.postPhonemeLength = options->post_phoneme_length;
+  auto& post = result.postProcess;
+  post.volumeScale = options->volume_scale;
+  switch (options->normalization) {
+    case VV_NORMALIZATION_PEAK:
+      post.normalization = vvengine::Normalization::kPeak;
+      break;
+    case VV_NORMALIZATION_RMS:
+      post.normalization = vvengine::Normalization::kRms;
+      break;
+    case VV_NORMALIZATION_LOUDNESS:
+      post.normalization = vvengine::Normalization::kLoudness;
+      break;
+    default:
+      post.normalization = vvengine::Normalization::kNone;
+      break;
+  }
+  post.targetLevel = options->target_level;
+  post.trimSilence = options->trim_silence != 0;
+  post.trimThresholdDb = options->trim_threshold_db;
+  post.prePauseLength = options->pre_pause_length;
+  post.postPauseLength = options->post_pause_length;
+  return result;
+}
+
+// Exceptions must not cross the C boundary: every entry point catches (...).
+vv_status Synthesize(vv_engine* engine, const char* text, int64_t speakerId,
+                     const vv_synthesis_options* options,
+                     std::vector<float>& wave) {
+  if (engine == nullptr || text == nullptr)
+    return VV_ERROR_INVALID_ARGUMENT;
+  if (!engine->initialized) return VV_ERROR_NOT_INITIALIZED;
+  if (!engine->engine.TextToSpeech(text, speakerId, wave,
+                                   ToSynthesisOptions(options)))
+    return VV_ERROR_SYNTHESIS_FAILED;
+  return VV_OK;
+}
+}  // namespace
+
+int vv_sampling_rate(void) { return vvengine::kSamplingRate; }
+
+void vv_synthesis_options_init(vv_synthesis_options* options,
+                               size_t struct_size) {
+  if (options == nullptr || struct_size < sizeof(options->struct_size))
+    return;
+  vv_synthesis_options defaults = DefaultOptions();
+  std::memcpy(options, &defaults, std::min(struct_size, sizeof(defaults)));
+  options->struct_size = struct_size;
+}
+
+vv_engine* vv_engine_create(void) {
+  try {
+    return new vv_engine;
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void vv_engine_destroy(vv_engine* engine) { delete engine; }
+
+vv_status vv_engine_initialize(vv_engine* engine, int use_cuda) {
+  if (engine == nullptr) return VV_ERROR_INVALID_ARGUMENT;
+  try {
+    if (!engine->engine.Initialize(use_cuda != 0))
+      return VV_ERROR_NOT_INITIALIZED;
+  } catch (...) {
+    return VV_ERROR_NOT_INITIALIZED;
+  }
+  engine->initialized = true;
+  return VV_OK;
+}
+
+vv_status vv_engine_reload_user_dictionary(vv_engine* engine,
+                                           const char* user_dic_path) {
+  if (engine == nullptr) return VV_ERROR_INVALID_ARGUMENT;
+  if (!engine->initialized) return VV_ERROR_NOT_INITIALIZED;
+  try {
+    if (!engine->engine.ReloadUserDictionary(user_dic_path))
+      return VV_ERROR_INVALID_ARGUMENT;
+  } catch (...) {
+    return VV_ERROR_INVALID_ARGUMENT;
+  }
+  return VV_OK;
+}
+
+vv_status vv_engine_synthesize(vv_engine* engine, const char* text,
+                               int64_t speaker_id,
+                               const vv_synthesis_options* options,
+                               vv_buffer** out) {
+  if (out == nullptr) return VV_ERROR_INVALID_ARGUMENT;
+  *out = nullptr;
+  vv_synthesis_options full;
+  if (!ReadOptions(options, full)) return VV_ERROR_INVALID_ARGUMENT;
+  vv_buffer* buffer = nullptr;
+  try {
+    buffer = new vv_buffer;
+    vv_status status = Synthesize(engine, text, speaker_id, &full,
+                                  buffer->wave);
+    if (status != VV_OK) {
+      delete buffer;
+      return status;
+    }
+  } catch (...) {
+    delete buffer;
+    return VV_ERROR_SYNTHESIS_FAILED;
+  }
+  *out = buffer;
+  return VV_OK;
+}
+
+vv_status vv_engine_synthesize_into(vv_engine* engine, const char* text,
+                                    int64_t speaker_id,
+                                    const vv_synthesis_options* options,
+                                    float* samples, size_t capacity,
+                                    size_t* length) {
+  if (engine == nullptr || text == nullptr || length == nullptr ||
+      (samples == nullptr && capacity > 0))
+    return VV_ERROR_INVALID_ARGUMENT;
+  vv_synthesis_options full;
+  if (!ReadOptions(options, full)) return VV_ERROR_INVALID_ARGUMENT;
+  try {
+    std::vector<float> wave;
+    vv_status status = Synthesize(engine, text, speaker_id, &full, wave);
+    if (status != VV_OK) return status;
+    *length = wave.size();
+    if (wave.size() > capacity) return VV_ERROR_BUFFER_TOO_SMALL;
+    if (!wave.empty())
+      std::memcpy(samples, wave.data(), wave.size() * sizeof(float));
+  } catch (...) {
+    return VV_ERROR_SYNTHESIS_FAILED;
+  }
+  return VV_OK;
+}
+
+vv_status vv_engine_synthesize_stream(vv_engine* engine, const char* text,
+                                      int64_t speaker_id,
+                                      const vv_synthesis_options* options,
+                                      size_t chunk_length,
+                                      vv_chunk_callback callback,
+                                      void* user_data) {
+  if (callback == nullptr) return VV_ERROR_INVALID_ARGUMENT;
+  vv_synthesis_options full;
+  if (!ReadOptions(options, full)) return VV_ERROR_INVALID_ARGUMENT;
+  // The decoder runs over the whole utterance at once, so the chunks are
+  // views into that single buffer.
+  std::vector<float> wave;
+  try {
+    vv_status status = Synthesize(engine, text, speaker_id, &full, wave);
+    if (status != VV_OK) return status;
+  } catch (...) {
+    return VV_ERROR_SYNTHESIS_FAILED;
+  }
+  if (chunk_length == 0) chunk_length = std::max<size_t>(wave.size(), 1);
+  for (size_t offset = 0; offset < wave.size(); offset += chunk_length) {
+    size_t n = std::min(chunk_length, wave.size() - offset);
+    if (callback(wave.data() + offset, n, user_data) != 0)
+      return VV_ERROR_CANCELLED;
+  }
+  return VV_OK;
+}
+
+const float* vv_buffer_data(const vv_buffer* buffer) {
+  return buffer ? buffer->wave.data() : nullptr;
+}
+
+size_t vv_buffer_length(const vv_buffer* buffer) {
+  return buffer ? buffer->wave.size() : 0;
+}
+
+size_t vv_buffer_copy(const vv_buffer* buffer, float* samples,
+                      size_t capacity) {
+  if (buffer == nullptr || samples == nullptr) return 0;
+  size_t n = std::min(capacity, buffer->wave.size());
+  if (n > 0) std::memcpy(samples, buffer->wave.data(), n * sizeof(float));
+  return n;
+}
+
+void vv_buffer_release(vv_buffer* buffer) { delete buffer; }
@@ -4,27 +4,156 @@
 
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <list>
+#include <mutex>
 
 #include "vvengine/acoustic_feature_extractor.h"
 #include "vvengine/full_context_label.h"
 #include "vvengine/openjtalk_wrapper.h"
+#include "null_stream.h"
 
 namespace vvengine {
 
-class NullStream : public std::streambuf, public std::ostream {
- public:
-  virtual int overflow(int c) { return c; }
-  NullStream() : std::ostream(this) {}
-};
+constexpr int kFrameRate = 200;
+constexpr size_t kAnalysisCacheSize = 16;
+
+namespace {
+// AudioQuery is public and may have been edited by the caller, so everything
+// Synthesize() indexes with is checked up front.
+bool IsValidQuery(const AudioQuery& query) {
+  const size_t n = query.phonemeIds.size();
+  if (n == 0 || query.phonemeLength.size() != n ||
+      query.phonemes.size() != n || query.vowelIndices.empty() ||
+      query.f0List.size() != query.vowelIndices.size())
+    return false;
+  const long numPhoneme = OjtPhoneme{}.num_phoneme;
+  for (long id : query.phonemeIds)
+    if (id < 0 || id >= numPhoneme) return false;
+  int previous = -1;
+  for (int v : query.vowelIndices) {
+    if (v <= previous || v >= (int)n) return false;
+    previous = v;
+  }
+  for (float len : query.phonemeLength)
+    if (!std::isfinite(len)) return false;
+  for (float f : query.f0List)
+    if (!std::isfinite(f)) return false;
+  return true;
+}
+
+bool IsValidOptions(const SynthesisOptions& options) {
+  return std::isfinite(options.speedScale) && options.speedScale > 0 &&
+         std::isfinite(options.pitchScale) &&
+         std::isfinite(options.intonationScale) &&
+         std::isfinite(options.prePhonemeLength) &&
+         std::isfinite(options.postPhonemeLength);
+}
+}  // namespace
 
 struct Engine::Impl {
-  OpenJtalkWrapper openjtalk;
+  // Swapped with std::atomic_store on dictionary reload. Requests hold their
+  // own reference, so they finish on the context they started with.
+  std::shared_ptr<OpenJtalkWrapper> openjtalk;
+  // Freeing a context (MeCab model, dictionaries, NJD/JPCommon) is slow, so
+  // the deleter of `openjtalk` only parks it here and reloads free it; a
+  // request dropping the last reference never pays for it.
+  std::mutex retiredMutex;
+  std::condition_variable retiredCondition;
+  std::vector<OpenJtalkWrapper*> retired;
+  std::mutex reloadMutex;  // one reload at a time
   bool initialized;
   std::shared_ptr<std::ostream> pLogger;
 
+  // Most recently used first. An analysis is only stored if no dictionary
+  // reload happened while it ran, so the cache never serves stale readings.
+  struct CacheEntry {
+    std::string text;
+    long speakerId;
+    std::shared_ptr<const AudioQuery> query;
+  };
+  std::mutex cacheMutex;
+  std::list<CacheEntry> cache;
+  unsigned long dictionaryGeneration;
+
   Impl()
-      : openjtalk(), initialized(false), pLogger(new NullStream) {}
-  ~Impl() {}
+      : openjtalk(), initialized(false), pLogger(new NullStream),
+        dictionaryGeneration(0) {}
+  ~Impl() {
+    openjtalk.reset();
+    for (auto* wrapper : retired) delete wrapper;
+  }
+
+  std::shared_ptr<const AudioQuery> FindQuery(const std::string& text,
+                                              long speakerId) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (auto it = cache.begin(); it != cache.end(); ++it) {
+      if (it->speakerId == speakerId && it->text == text) {
+        cache.splice(cache.begin(), cache, it);
+        return it->query;
+      }
+    }
+    return nullptr;
+  }
+
+  void StoreQuery(const std::string& text, long speakerId,
+                  unsigned long generation,
+                  const std::shared_ptr<const AudioQuery>& query) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (generation != dictionaryGeneration) return;
+    cache.push_front(CacheEntry{text, speakerId, query});
+    if (cache.size() > kAnalysisCacheSize) cache.pop_back();
+  }
+
+  unsigned long Generation() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return dictionaryGeneration;
+  }
+
+  void InvalidateQueries() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    dictionaryGeneration++;
+    cache.clear();
+  }
+
+  void Retire(OpenJtalkWrapper* wrapper) {
+    {
+      std::lock_guard<std::mutex> lock(retiredMutex);
+      retired.push_back(wrapper);
+    }
+    retiredCondition.notify_all();
+  }
+
+  // Waits until `wrapper` (already swapped out) is retired, then frees every
+  // retired context.
+  void FreeRetired(const OpenJtalkWrapper* wrapper) {
+    std::vector<OpenJtalkWrapper*> garbage;
+    {
+      std::unique_lock<std::mutex> lock(retiredMutex);
+      retiredCondition.wait(lock, [&] {
+        return !wrapper || std::find(retired.begin(), retired.end(),
+                                     wrapper) != retired.end();
+      });
+      garbage.swap(retired);
+    }
+    for (auto* w : garbage) delete w;
+  }
+
+  std::shared_ptr<OpenJtalkWrapper> LoadOpenJtalk(const char* userDic) {
+    std::shared_ptr<OpenJtalkWrapper> wrapper(
+        new OpenJtalkWrapper, [this](OpenJtalkWrapper* w) { Retire(w); });
+    if (!wrapper->Initialize()) {
+      *pLogger << "[ERROR] Failed to initialize Openjtalk." << std::endl;
+      return nullptr;
+    }
+    if (!wrapper->Load(kMecabDir, userDic)) {
+      *pLogger << "[ERROR] Failed to load the mecab dictionary." << std::endl;
+      return nullptr;
+    }
+    return wrapper;
+  }
 };
 
 Engine::Engine()
@@ -34,7 +163,7 @@ Engine::~Engine() {}
 void Engine::SetLogger(const std::shared_ptr<std::ostream>& os) {
   impl->pLogger = os;
 }
-bool Engine::Initialize(bool useCUDA) {
+bool Engine::Initialize(bool useCUDA, const char* userDicPath) {
   *impl->pLogger << (useCUDA ? "GPU" : "CPU") << " MODE" << std::endl;
 
   if (!initialize((char*)kCoreDir, useCUDA)) {
@@ -47,33 +176,56 @@ bool Engine::Initialize(bool useCUDA) {
     *impl->pLogger << "Openjtalk is already initialized. Skipping..."
                    << std::endl;
   } else {
-    if (!impl->openjtalk.Initialize()) {
-      *impl->pLogger << "[ERROR] Failed to initialize Openjtalk." << std::endl;
-      return false;
-    }
-    if (!impl->openjtalk.Load(kMecabDir)) {
-      *impl->pLogger << "[ERROR] Failed to load the mecab dictionary."
+    auto openjtalk = impl->LoadOpenJtalk(userDicPath);
+    if (!openjtalk && userDicPath && userDicPath[0]) {
+      *impl->pLogger << "[ERROR] Failed to load the user dictionary. Using "
+                        "the system dictionary alone."
                      << std::endl;
-      return false;
+      openjtalk = impl->LoadOpenJtalk(nullptr);
     }
+    if (!openjtalk) return false;
+    std::atomic_store(&impl->openjtalk, openjtalk);
   }
   impl->initialized = true;
   return true;
 }
-bool Engine::TextToSpeech(const char* textUtf8, long speakerId,
-                          std::vector<float>& wave) {
+bool Engine::ReloadUserDictionary(const char* userDicPath) {
+  if (!impl->initialized) {
+    *impl->pLogger << "[ERROR] This engine is not initialized." << std::endl;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> reloadLock(impl->reloadMutex);
+  // Build the new context while requests keep running on the current one.
+  auto openjtalk = impl->LoadOpenJtalk(userDicPath);
+  if (!openjtalk) {
+    impl->FreeRetired(nullptr);
+    return false;
+  }
+  auto old = std::atomic_exchange(&impl->openjtalk, openjtalk);
+  impl->InvalidateQueries();
+
+  // In-flight requests keep their own reference to the old context; the last
+  // of them retires it, and it is freed here.
+  const OpenJtalkWrapper* oldWrapper = old.get();
+  old.reset();
+  impl->FreeRetired(oldWrapper);
+  *impl->pLogger << "user dictionary reloaded" << std::endl;
+  return true;
+}
+bool Engine::Analyze(const char* textUtf8, long speakerId,
+                     AudioQuery& query) {
   if (!impl->initialized) {
     *impl->pLogger << "[ERROR] This engine is not initialized." << std::endl;
     return false;
   }
 
   std::vector<std::string> labels;
-  impl->openjtalk.ExtractFullContext(textUtf8, labels);
+  std::atomic_load(&impl->openjtalk)->ExtractFullContext(textUtf8, labels);
 
   *impl->pLogger << "===== extract fullcontext =====" << std::endl;
   for (const auto& s : labels) *impl->pLogger << s << std::endl;
 
-  int rate = 200;
   auto utterance = ExtractFullContextLabel(labels);
   *impl->pLogger << "utterance ok" << std::endl;
   auto labelDataList = utterance.phonemes();
@@ -121,9 +273,6 @@ bool Engine::TextToSpeech(const char* textUtf8, long speakerId,
     return false;
   }
 
-  phonemeLength.front() = phonemeLength.back() = 0.1;
-  for (auto& len : phonemeLength) len = std::round(len * rate) / rate;
-
   for (const auto& p : phonemeDataList) *impl->pLogger << p.phoneme << " ";
   *impl->pLogger << std::endl;
 
@@ -159,20 +308,6 @@ bool Engine::TextToSpeech(const char* textUtf8, long speakerId,
   for (const auto& p : consonantPhonemeDataList)
     consonantPhonemeList.push_back(p ? p.value().phonemeId() : -1);
 
-  std::vector<float> phonemeLengthSA;
-  {
-    int i = 0;
-    for (size_t vi = 0; vi + 1 < vowelIndices.size(); vi++) {
-      int v = vowelIndices[vi];
-      float a = 0;
-      for (; i < v + 1; i++) a += phonemeLength[i];
-      phonemeLengthSA.push_back(a);
-    }
-    float a = 0;
-    for (; i < (int)phonemeLength.size(); i++) a += phonemeLength[i];
-    phonemeLengthSA.push_back(a);
-  }
-
   std::vector<float> f0List(vowelPhonemeList.size());
   std::vector<long> startAccentListVowel, endAccentListVowel,
       startAccentPhraseListVowel, endAccentPhraseListVowel;
@@ -199,7 +334,73 @@ bool Engine::TextToSpeech(const char* textUtf8, long speakerId,
     }
   }
 
-  std::vector<long> phoneme, f0;
+  query.speakerId = speakerId;
+  query.utterance = std::move(utterance);
+  query.phonemes.clear();
+  for (const auto& p : phonemeDataList) query.phonemes.push_back(p.phoneme);
+  query.phonemeIds = std::move(phonemeListS);
+  query.phonemeLength = std::move(phonemeLength);
+  query.vowelIndices = std::move(vowelIndices);
+  query.f0List = std::move(f0List);
+  return true;
+}
+bool Engine::Synthesize(const AudioQuery& query, std::vector<float>& wave,
+                        const SynthesisOptions& options, Timeline* timeline) {
+  if (!impl->initialized) {
+    *impl->pLogger << "[ERROR] This engine is not initialized." << std::endl;
+    return false;
+  }
+  if (!IsValidQuery(query) || !IsValidOptions(options)) {
+    *impl->pLogger << "[ERROR] Invalid query or options." << std::endl;
+    return false;
+  }
+
+  const int rate = kFrameRate;
+  long speakerId = query.speakerId;
+  const auto& phonemeListS = query.phonemeIds;
+  const auto& vowelIndices = query.vowelIndices;
+
+  std::vector<float> phonemeLength = query.phonemeLength;
+  phonemeLength.front() = options.prePhonemeLength;
+  phonemeLength.back() = options.postPhonemeLength;
+  for (auto& len : phonemeLength)
+    len = std::round(std::max(0.0f, len) / options.speedScale * rate) / rate;
+
+  std::vector<float> phonemeLengthSA;
+  {
+    int i = 0;
+    for (size_t vi = 0; vi + 1 < vowelIndices.size(); vi++) {
+      int v = vowelIndices[vi];
+      float a = 0;
+      for (; i < v + 1; i++) a += phonemeLength[i];
+      phonemeLengthSA.push_back(a);
+    }
+    float a = 0;
+    for (; i < (int)phonemeLength.size(); i++) a += phonemeLength[i];
+    phonemeLengthSA.push_back(a);
+  }
+
+  std::vector<float> f0List = query.f0List;
+  if (options.intonationScale != 1.0f) {
+    float sum = 0;
+    int voiced = 0;
+    for (float f : f0List) {
+      if (f > 0) {
+        sum += f;
+        voiced++;
+      }
+    }
+    float mean = voiced > 0 ? sum / voiced : 0;
+    for (auto& f : f0List)
+      if (f > 0) f = (f - mean) * options.intonationScale + mean;
+  }
+  if (options.pitchScale != 0.0f) {
+    float pitch = std::pow(2.0f, options.pitchScale);
+    for (auto& f : f0List) f *= pitch;
+  }
+
+  std::vector<long> phoneme;
+  std::vector<float> f0;
   for (size_t i = 0; i < phonemeListS.size(); i++)
     for (int j = 0; j < std::round(phonemeLength[i] * rate); j++)
       phoneme.push_back(phonemeListS[i]);
@@ -213,10 +414,11 @@ bool Engine::TextToSpeech(const char* textUtf8, long speakerId,
       ff0(phoneme.size());
   for (size_t i = 0; i < phoneme.size(); i++)
     onehotPhoneme[i * phonemeSize + phoneme[i]] = 1;
-  for (size_t i = 0; i < phoneme.size(); i++) ff0[i] = (float)f0[i];
+  for (size_t i = 0; i < phoneme.size(); i++) ff0[i] = f0[i];
 
-  ff0 = Resample(ff0, rate, 24000.0 / 256.0);
-  onehotPhoneme = Resample(onehotPhoneme, rate, 24000.0 / 256.0, phonemeSize);
+  ff0 = Resample(ff0, rate, kSamplingRate / 256.0);
+  onehotPhoneme = Resample(onehotPhoneme, rate, kSamplingRate / 256.0,
+                           phonemeSize);
 
   wave.resize(ff0.size() * 256);
   if (decode_forward(ff0.size(), phonemeSize, ff0.data(), onehotPhoneme.data(),
@@ -226,7 +428,40 @@ bool Engine::TextToSpeech(const char* textUtf8, long speakerId,
     return false;
   }
 
+  long shift = PostProcess(wave, kSamplingRate, options.postProcess);
+
+  if (timeline) {
+    std::vector<long> phonemeSamples;
+    for (float len : phonemeLength)
+      phonemeSamples.push_back(std::lround(len * rate) *
+                               (kSamplingRate / rate));
+    *timeline = Timeline::FromDurations(query.utterance, query.phonemes,
+                                        phonemeSamples);
+    timeline->Shift(shift, wave.size());
+  }
+
   return true;
 }
+bool Engine::TextToSpeech(const char* textUtf8, long speakerId,
+                          std::vector<float>& wave,
+                          const SynthesisOptions& options,
+                          Timeline* timeline) {
+  if (!impl->initialized) {
+    *impl->pLogger << "[ERROR] This engine is not initialized." << std::endl;
+    return false;
+  }
+
+  auto query = impl->FindQuery(textUtf8, speakerId);
+  if (query) {
+    *impl->pLogger << "analysis cache hit" << std::endl;
+  } else {
+    unsigned long generation = impl->Generation();
+    auto analyzed = std::make_shared<AudioQuery>();
+    if (!Analyze(textUtf8, speakerId, *analyzed)) return false;
+    impl->StoreQuery(textUtf8, speakerId, generation, analyzed);
+    query = analyzed;
+  }
+  return Synthesize(*query, wave, options, timeline);
+}
 
-}  // namespace vvengine
\ No newline at end of file
+}  // namespace vvengine
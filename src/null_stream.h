@@ -0,0 +1,16 @@
+#ifndef VVENGINE_NULL_STREAM_H_
+#define VVENGINE_NULL_STREAM_H_
+
+#include <ostream>
+#include <streambuf>
+
+namespace vvengine {
+// Default logger: discards everything.
+class NullStream : public std::streambuf, public std::ostream {
+ public:
+  virtual int overflow(int c) { return c; }
+  NullStream() : std::ostream(this) {}
+};
+}  // namespace vvengine
+
+#endif  // VVENGINE_NULL_STREAM_H_
@@ -14,12 +14,43 @@
 #include <openjtalk/text2mecab.h>
 
 #include <iostream>
+#include <mutex>
+#include <string>
 
 namespace vvengine {
+namespace {
+// Mecab_load() plus `-u userDic`; mirrors its implementation.
+BOOL MecabLoadWithUserDic(Mecab* m, const char* dicdir, const char* userDic) {
+  Mecab_clear(m);
+  std::vector<std::string> args = {"mecab", "-d", dicdir, "-u", userDic};
+  std::vector<char*> argv;
+  for (auto& arg : args) argv.push_back(&arg[0]);
+
+  MeCab::Model* model = MeCab::createModel(argv.size(), argv.data());
+  if (model == nullptr) return FALSE;
+  MeCab::Tagger* tagger = model->createTagger();
+  if (tagger == nullptr) {
+    delete model;
+    return FALSE;
+  }
+  MeCab::Lattice* lattice = model->createLattice();
+  if (lattice == nullptr) {
+    delete tagger;
+    delete model;
+    return FALSE;
+  }
+  m->model = model;
+  m->tagger = tagger;
+  m->lattice = lattice;
+  return TRUE;
+}
+}  // namespace
+
 struct OpenJtalkWrapper::Impl {
   Mecab mecab;
   NJD njd;
   JPCommon jpcommon;
+  std::mutex mutex;
 
   Impl() : mecab(), njd(), jpcommon() {}
 
@@ -48,8 +79,16 @@ bool OpenJtalkWrapper::Load(const char* mecabDir) {
   return mecabState == TRUE;
 }
 
+bool OpenJtalkWrapper::Load(const char* mecabDir, const char* userDic) {
+  if (userDic == nullptr || userDic[0] == '\0') return Load(mecabDir);
+  BOOL mecabState;
+  mecabState = MecabLoadWithUserDic(&impl->mecab, mecabDir, userDic);
+  return mecabState == TRUE;
+}
+
 void OpenJtalkWrapper::ExtractFullContext(const char* text,
                                           std::vector<std::string>& labels) {
+  std::lock_guard<std::mutex> lock(impl->mutex);
   BOOL mecabState;
   char buff[8192];
 
@@ -0,0 +1,198 @@
+#include "vvengine/post_processor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace vvengine {
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+
+inline float DbToAmplitude(float db) { return std::pow(10.0f, db / 20.0f); }
+
+struct Biquad {
+  double b0, b1, b2, a1, a2;
+  double z1 = 0, z2 = 0;
+
+  inline double Process(double x) {
+    double y = b0 * x + z1;
+    z1 = b1 * x - a1 * y + z2;
+    z2 = b2 * x - a2 * y;
+    return y;
+  }
+};
+
+// The two K-weighting stages of BS.1770, designed for an arbitrary rate with
+// the RBJ cookbook formulas (same parameters as pyloudnorm).
+Biquad KWeightingShelf(int rate) {
+  const double A = std::pow(10.0, 4.0 / 40.0);
+  const double w0 = 2 * kPi * 1500.0 / rate;
+  const double alpha = std::sin(w0) / (2 / std::sqrt(2.0));
+  const double c = std::cos(w0);
+  const double s = 2 * std::sqrt(A) * alpha;
+  const double a0 = (A + 1) - (A - 1) * c + s;
+  return Biquad{A * ((A + 1) + (A - 1) * c + s) / a0,
+                -2 * A * ((A - 1) + (A + 1) * c) / a0,
+                A * ((A + 1) + (A - 1) * c - s) / a0,
+                2 * ((A - 1) - (A + 1) * c) / a0,
+                ((A + 1) - (A - 1) * c - s) / a0};
+}
+
+Biquad KWeightingHighPass(int rate) {
+  const double w0 = 2 * kPi * 38.0 / rate;
+  const double alpha = std::sin(w0) / (2 * 0.5);
+  const double c = std::cos(w0);
+  const double a0 = 1 + alpha;
+  return Biquad{(1 + c) / 2 / a0, -(1 + c) / a0, (1 + c) / 2 / a0,
+                -2 * c / a0, (1 - alpha) / a0};
+}
+
+// Gated integrated loudness in LUFS: 400 ms blocks with 75% overlap, -70 LUFS
+// absolute gate, -10 LU relative gate. Returns -inf for silence.
+double Loudness(const float* x, size_t n, int rate) {
+  Biquad shelf = KWeightingShelf(rate), highPass = KWeightingHighPass(rate);
+  const size_t hop = std::max(1, rate / 10);
+  std::vector<double> hops;
+  double acc = 0, total = 0;
+  for (size_t i = 0; i < n; i++) {
+    double y = highPass.Process(shelf.Process(x[i]));
+    acc += y * y;
+    if ((i + 1) % hop == 0) {
+      hops.push_back(acc);
+      total += acc;
+      acc = 0;
+    }
+  }
+  total += acc;
+
+  std::vector<double> blocks;
+  for (size_t i = 0; i + 4 <= hops.size(); i++)
+    blocks.push_back((hops[i] + hops[i + 1] + hops[i + 2] + hops[i + 3]) /
+                     (4 * hop));
+  if (blocks.empty() && n > 0) blocks.push_back(total / n);
+
+  auto lufs = [](double z) { return -0.691 + 10 * std::log10(z); };
+  auto gatedMean = [&](double gate) {
+    double sum = 0;
+    int count = 0;
+    for (double z : blocks) {
+      if (z > 0 && lufs(z) > gate) {
+        sum += z;
+        count++;
+      }
+    }
+    return count > 0 ? sum / count : 0.0;
+  };
+  double z = gatedMean(-70.0);
+  if (z <= 0) return -std::numeric_limits<double>::infinity();
+  // Blocks must pass both gates; on quiet input the relative one alone would
+  // fall below -70 LUFS and let the noise floor back in.
+  z = gatedMean(std::max(-70.0, lufs(z) - 10.0));
+  return lufs(z);
+}
+}  // namespace
+
+long PostProcess(std::vector<float>& wave, int rate,
+                 const PostProcessOptions& options) {
+  const bool normalize = options.normalization != Normalization::kNone;
+  if (!normalize && !options.trimSilence && options.volumeScale == 1.0f)
+    return 0;
+
+  const size_t n = wave.size();
+  size_t begin = 0, end = n;
+  float peak = 0;
+  double energy = 0;
+
+  // Analysis pass: per-frame energy and peak, from which both the trimming
+  // bounds and the normalization statistics of the kept span are derived.
+  if (normalize || options.trimSilence) {
+    const float* x = wave.data();
+    const size_t frame = std::max(1, rate / 100);
+    const size_t numFrames = (n + frame - 1) / frame;
+    std::vector<float> framePeak(numFrames);
+    std::vector<double> frameEnergy(numFrames);
+    for (size_t f = 0; f < numFrames; f++) {
+      const size_t b = f * frame, e = std::min(n, b + frame);
+      float s = 0, p = 0;
+#pragma omp simd reduction(+ : s) reduction(max : p)
+      for (size_t i = b; i < e; i++) {
+        float a = std::fabs(x[i]);
+        s += a * a;
+        p = p > a ? p : a;
+      }
+      framePeak[f] = p;
+      frameEnergy[f] = s;
+    }
+
+    size_t first = 0, last = numFrames;
+    if (options.trimSilence) {
+      const double threshold = std::pow(10.0, options.trimThresholdDb / 10.0);
+      auto audible = [&](size_t f) {
+        size_t length = std::min(n, (f + 1) * frame) - f * frame;
+        return frameEnergy[f] >= threshold * length;
+      };
+      while (first < last && !audible(first)) first++;
+      while (last > first && !audible(last - 1)) last--;
+      if (first == last) {
+        begin = end = 0;  // all silent: only the pauses remain
+      } else {
+        begin = first * frame;
+        end = std::min(n, last * frame);
+      }
+    }
+    for (size_t f = first; f < last; f++) {
+      peak = std::max(peak, framePeak[f]);
+      energy += frameEnergy[f];
+    }
+  }
+
+  float gain = options.volumeScale;
+  if (end > begin) {
+    switch (options.normalization) {
+      case Normalization::kNone:
+        break;
+      case Normalization::kPeak:
+        if (peak > 0) gain *= DbToAmplitude(options.targetLevel) / peak;
+        break;
+      case Normalization::kRms:
+        if (energy > 0)
+          gain *= DbToAmplitude(options.targetLevel) /
+                  std::sqrt(energy / (end - begin));
+        break;
+      case Normalization::kLoudness: {
+        double loudness = Loudness(wave.data() + begin, end - begin, rate);
+        if (std::isfinite(loudness))
+          gain *= DbToAmplitude(options.targetLevel - (float)loudness);
+        break;
+      }
+    }
+  }
+
+  // Write pass: the kept span is scaled as it is moved into place, so every
+  // sample is touched once. The copy runs away from the overlap.
+  size_t pre = 0, post = 0;
+  if (options.trimSilence) {
+    pre = (size_t)std::lround(std::max(0.0f, options.prePauseLength) * rate);
+    post = (size_t)std::lround(std::max(0.0f, options.postPauseLength) * rate);
+  }
+  const size_t length = end - begin;
+  const size_t size = pre + length + post;
+  if (size > wave.size()) wave.resize(size);
+  float* y = wave.data();
+  float* span = y + pre;
+  const float* kept = y + begin;
+  if (pre < begin) {
+    for (size_t i = 0; i < length; i++) span[i] = kept[i] * gain;
+  } else if (pre > begin) {
+    for (size_t i = length; i > 0; i--) span[i - 1] = kept[i - 1] * gain;
+  } else if (gain != 1.0f) {
+#pragma omp simd
+    for (size_t i = 0; i < length; i++) span[i] *= gain;
+  }
+  std::fill(y, y + pre, 0.0f);
+  std::fill(y + pre + length, y + size, 0.0f);
+  wave.resize(size);
+  return (long)pre - (long)begin;
+}
+
+}  // namespace vvengine
@@ -0,0 +1,834 @@
+#include "vvengine/supervisor.h"
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include "null_stream.h"
+
+namespace vvengine {
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// Backoff between attempts to bring a dead worker back.
+constexpr Clock::duration kMinRespawnDelay = std::chrono::milliseconds(500);
+constexpr Clock::duration kMaxRespawnDelay = std::chrono::seconds(30);
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+enum MessageType : uint32_t {
+  kReady = 1,
+  kSynthesize,
+  kChunk,
+  kAck,
+  kDone,
+  kError,
+  kReload,
+  kSpawn,
+  kReap,
+};
+
+struct Message {
+  uint32_t type;
+  // kSynthesize: speaker id, kSpawn: worker index,
+  // kReap and the spawner's kReady: worker pid
+  int64_t value;
+  // kSynthesize: bytes of text that follow, kChunk: samples,
+  // kReload and kSpawn: bytes of the user dictionary path that follow,
+  // kReap: 1 to SIGKILL the worker first
+  uint64_t size;
+};
+// kSynthesize is followed by the text and then the raw SynthesisOptions;
+// both ends are the same binary.
+static_assert(std::is_trivially_copyable<SynthesisOptions>::value,
+              "SynthesisOptions is sent to workers as raw bytes.");
+
+// Single-producer (worker) single-consumer (supervisor) ring living at the
+// start of a MAP_SHARED mapping, followed by `capacity` samples.
+struct AudioRing {
+  std::atomic<uint64_t> head;
+  std::atomic<uint64_t> tail;
+  uint64_t capacity;
+
+  inline float* data() { return reinterpret_cast<float*>(this + 1); }
+  inline static size_t Bytes(size_t capacity) {
+    return sizeof(AudioRing) + capacity * sizeof(float);
+  }
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "AudioRing is shared across processes.");
+
+bool ReadAll(int fd, void* buf, size_t size) {
+  char* p = static_cast<char*>(buf);
+  while (size > 0) {
+    ssize_t n = read(fd, p, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool WriteAll(int fd, const void* buf, size_t size) {
+  const char* p = static_cast<const char*>(buf);
+  while (size > 0) {
+    ssize_t n = send(fd, p, size, kSendFlags);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool SendMessage(int fd, uint32_t type, uint64_t size = 0,
+                 int64_t value = 0) {
+  Message m{type, value, size};
+  return WriteAll(fd, &m, sizeof(m));
+}
+
+// Sends `m` with the two descriptors `fds` attached (SCM_RIGHTS), or alone if
+// `fds` is null.
+bool SendMessageWithFds(int socket, const Message& m, const int* fds) {
+  iovec iov{const_cast<Message*>(&m), sizeof(m)};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  alignas(cmsghdr) char control[CMSG_SPACE(2 * sizeof(int))];
+  if (fds) {
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(2 * sizeof(int));
+    std::memcpy(CMSG_DATA(c), fds, 2 * sizeof(int));
+  }
+  ssize_t n;
+  do {
+    n = sendmsg(socket, &msg, kSendFlags);
+  } while (n < 0 && errno == EINTR);
+  return n == (ssize_t)sizeof(m);
+}
+
+// Receives a message and up to two attached descriptors (-1 if absent).
+bool ReceiveMessageWithFds(int socket, Message& m, int* fds) {
+  iovec iov{&m, sizeof(m)};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  alignas(cmsghdr) char control[CMSG_SPACE(2 * sizeof(int))];
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t n;
+  do {
+    n = recvmsg(socket, &msg, 0);
+  } while (n < 0 && errno == EINTR);
+  fds[0] = fds[1] = -1;
+  for (cmsghdr* c = CMSG_FIRSTHDR(&msg); n > 0 && c; c = CMSG_NXTHDR(&msg, c))
+    if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS)
+      std::memcpy(fds, CMSG_DATA(c),
+                  std::min<size_t>(c->cmsg_len - CMSG_LEN(0), 2 * sizeof(int)));
+  if (n == (ssize_t)sizeof(m)) return true;
+  for (int i = 0; i < 2; i++)
+    if (fds[i] >= 0) close(fds[i]);
+  return false;
+}
+
+// Streams `wave` through the ring. Every kChunk is answered by one kAck once
+// the supervisor has consumed it; we only block on those when the ring is full.
+bool StreamWave(int fd, AudioRing* ring, const std::vector<float>& wave) {
+  const uint64_t capacity = ring->capacity;
+  size_t pending = 0;
+  size_t offset = 0;
+  Message ack;
+  while (offset < wave.size()) {
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint64_t used = head - ring->tail.load(std::memory_order_acquire);
+    if (used == capacity) {
+      if (!ReadAll(fd, &ack, sizeof(ack))) return false;
+      pending--;
+      continue;
+    }
+    size_t n = std::min<size_t>(capacity - used, wave.size() - offset);
+    size_t begin = head % capacity;
+    size_t first = std::min<size_t>(n, capacity - begin);
+    std::memcpy(ring->data() + begin, wave.data() + offset,
+                first * sizeof(float));
+    std::memcpy(ring->data(), wave.data() + offset + first,
+                (n - first) * sizeof(float));
+    ring->head.store(head + n, std::memory_order_release);
+    if (!SendMessage(fd, kChunk, n)) return false;
+    pending++;
+    offset += n;
+  }
+  if (!SendMessage(fd, kDone)) return false;
+  for (; pending > 0; pending--) {
+    if (!ReadAll(fd, &ack, sizeof(ack))) return false;
+  }
+  return true;
+}
+
+// Reloads run on their own thread and socket, so the worker keeps serving
+// requests while the new dictionary is being built.
+void ServeReloads(int controlFd, Engine& engine) {
+  Message request;
+  std::string path;
+  while (ReadAll(controlFd, &request, sizeof(request)) &&
+         request.type == kReload) {
+    path.resize(request.size);
+    if (!ReadAll(controlFd, &path[0], path.size())) break;
+    bool ok = engine.ReloadUserDictionary(path.empty() ? nullptr
+                                                       : path.c_str());
+    if (!SendMessage(controlFd, ok ? kDone : kError)) break;
+  }
+}
+
+// Body of a worker process. Exits when the supervisor closes its socket.
+[[noreturn]] void RunWorker(int fd, int controlFd, AudioRing* ring,
+                           bool useCUDA, const std::string& userDic) {
+  // A user dictionary that fails to load leaves the worker on the system
+  // dictionary rather than down.
+  Engine engine;
+  if (!engine.Initialize(useCUDA,
+                         userDic.empty() ? nullptr : userDic.c_str())) {
+    SendMessage(fd, kError);
+    _exit(1);
+  }
+  if (!SendMessage(fd, kReady)) _exit(1);
+  std::thread(ServeReloads, controlFd, std::ref(engine)).detach();
+
+  Message request;
+  std::string text;
+  SynthesisOptions options;
+  std::vector<float> wave;
+  while (ReadAll(fd, &request, sizeof(request))) {
+    text.resize(request.size);
+    if (!ReadAll(fd, &text[0], text.size())) break;
+    if (request.type != kSynthesize) _exit(1);
+    if (!ReadAll(fd, &options, sizeof(options))) break;
+    if (!engine.TextToSpeech(text.c_str(), request.value, wave,
+                             options)) {
+      if (!SendMessage(fd, kError)) break;
+      continue;
+    }
+    if (!StreamWave(fd, ring, wave)) break;
+  }
+  _exit(0);
+}
+
+// Body of the spawner process. Start() forks it once, before the supervisor
+// has threads of its own, and every worker is forked from it: forking the
+// (multithreaded) host and then loading the models in the child is undefined.
+// Workers are its children, so it also kills and reaps them on request.
+[[noreturn]] void RunSpawner(int control, const std::vector<AudioRing*>& rings,
+                             bool useCUDA) {
+  Message request;
+  std::string userDic;
+  while (ReadAll(control, &request, sizeof(request))) {
+    if (request.type == kReap) {
+      if (request.size) kill(request.value, SIGKILL);
+      waitpid(request.value, nullptr, 0);
+      if (!SendMessage(control, kDone)) break;
+      continue;
+    }
+    if (request.type != kSpawn) break;
+    userDic.resize(request.size);
+    if (!ReadAll(control, &userDic[0], userDic.size())) break;
+
+    // Request and control (reload) sockets: {supervisor end, worker end}.
+    pid_t pid = -1;
+    int data[2], ctl[2];
+    if (request.value >= 0 && (size_t)request.value < rings.size() &&
+        socketpair(AF_UNIX, SOCK_STREAM, 0, data) == 0) {
+      if (socketpair(AF_UNIX, SOCK_STREAM, 0, ctl) == 0) {
+        AudioRing* ring = rings[request.value];
+        ring->head.store(0);
+        ring->tail.store(0);
+        pid = fork();
+        if (pid == 0) {
+          close(control);
+          close(data[0]);
+          close(ctl[0]);
+          RunWorker(data[1], ctl[1], ring, useCUDA, userDic);
+        }
+        close(ctl[1]);
+        if (pid < 0) close(ctl[0]);
+      }
+      close(data[1]);
+      if (pid < 0) close(data[0]);
+    }
+    // The supervisor's ends of the worker sockets are handed over; we keep no
+    // copy, so the worker sees EOF as soon as the supervisor closes them.
+    const int fds[2] = {data[0], ctl[0]};
+    bool sent = SendMessageWithFds(control, Message{pid > 0 ? kReady : kError,
+                                                    pid, 0},
+                                   pid > 0 ? fds : nullptr);
+    if (pid > 0) {
+      close(fds[0]);
+      close(fds[1]);
+    }
+    if (!sent) break;
+  }
+  _exit(0);
+}
+
+struct Worker {
+  pid_t pid = -1;  // -1 while the worker is down
+  int fd = -1;
+  int controlFd = -1;
+  bool reloading = false;  // controlFd in use; Reap waits for it
+  AudioRing* ring = nullptr;
+  bool busy = false;
+  long requests = 0;
+  long failures = 0;
+  long restarts = 0;
+  Clock::duration busyTime = Clock::duration::zero();
+  // Respawn schedule while pid == -1.
+  Clock::time_point respawnAt;
+  Clock::duration respawnDelay = kMinRespawnDelay;
+};
+
+enum class ReloadResult { kReloaded, kRejected, kDown };
+}  // namespace
+
+struct Supervisor::Impl {
+  SupervisorOptions options;
+  std::vector<Worker> workers;
+  std::shared_ptr<std::ostream> pLogger;
+  // `mutex` guards scheduling state and statistics. `spawnMutex` serializes
+  // requests to the spawner process over `spawnerFd`. `dictionaryMutex` is
+  // held across a whole rolling reload and around respawns, so a worker never
+  // comes back with a dictionary that is about to be rolled back.
+  mutable std::mutex mutex;
+  std::mutex spawnMutex;
+  std::mutex dictionaryMutex;
+  std::condition_variable idle;
+  std::condition_variable respawn;
+  std::thread respawner;
+  pid_t spawnerPid;
+  int spawnerFd;
+  Clock::time_point startTime;
+  // Dictionary every live worker has accepted; guarded by dictionaryMutex.
+  std::string userDic;
+  long requests;
+  uint64_t audioSamples;
+  bool started;
+  bool stopping;
+
+  Impl()
+      : pLogger(new NullStream), spawnerPid(-1), spawnerFd(-1), requests(0),
+        audioSamples(0), started(false), stopping(false) {}
+
+  bool StartSpawner();
+  bool Spawn(Worker& worker, const std::string& userDicPath);
+  bool WaitReadable(int fd, Clock::time_point deadline);
+  void Reap(Worker& worker, bool kill);
+  void RespawnLoop();
+  bool Exchange(Worker& worker, const char* text, long speakerId,
+                const SynthesisOptions& options, std::vector<float>& wave,
+                bool& ok, bool& delivered);
+  Worker* Acquire();
+  void Release(Worker& worker, Clock::duration elapsed, bool ok,
+               size_t samples);
+  void Retire(Worker& worker, Clock::duration elapsed);
+  ReloadResult Reload(Worker& worker, const std::string& userDicPath);
+};
+
+bool Supervisor::Impl::StartSpawner() {
+  std::vector<AudioRing*> rings;
+  for (const auto& w : workers) rings.push_back(w.ring);
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return false;
+#ifdef SO_NOSIGPIPE
+  int one = 1;
+  setsockopt(fds[0], SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    RunSpawner(fds[1], rings, options.useCUDA);
+  }
+  close(fds[1]);
+  spawnerPid = pid;
+  spawnerFd = fds[0];
+  return true;
+}
+
+bool Supervisor::Impl::Spawn(Worker& worker, const std::string& userDicPath) {
+  const int64_t index = &worker - workers.data();
+  Message reply;
+  int fds[2];
+  {
+    std::lock_guard<std::mutex> spawnLock(spawnMutex);
+    if (!SendMessage(spawnerFd, kSpawn, userDicPath.size(), index) ||
+        !WriteAll(spawnerFd, userDicPath.data(), userDicPath.size()) ||
+        !ReceiveMessageWithFds(spawnerFd, reply, fds)) {
+      *pLogger << "[ERROR] The spawner process is gone." << std::endl;
+      return false;
+    }
+  }
+  if (reply.type != kReady || fds[0] < 0 || fds[1] < 0) {
+    for (int fd : fds)
+      if (fd >= 0) close(fd);
+    *pLogger << "[ERROR] Failed to fork a worker." << std::endl;
+    return false;
+  }
+#ifdef SO_NOSIGPIPE
+  int one = 1;
+  for (int fd : fds)
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    worker.pid = reply.value;
+    worker.fd = fds[0];
+    worker.controlFd = fds[1];
+  }
+
+  const auto deadline =
+      Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double>(
+                             options.initTimeoutSeconds));
+  Message ready;
+  if (!WaitReadable(worker.fd, deadline) ||
+      !ReadAll(worker.fd, &ready, sizeof(ready)) || ready.type != kReady) {
+    *pLogger << "[ERROR] Worker " << worker.pid << " failed to initialize."
+             << std::endl;
+    Reap(worker, true);
+    return false;
+  }
+  *pLogger << "worker " << worker.pid << " ready" << std::endl;
+  return true;
+}
+
+// False on timeout or when Stop() is waiting for us.
+bool Supervisor::Impl::WaitReadable(int fd, Clock::time_point deadline) {
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (stopping) return false;
+    }
+    auto now = Clock::now();
+    if (now >= deadline) return false;
+    auto slice = std::min<Clock::duration>(deadline - now,
+                                           std::chrono::milliseconds(200));
+    pollfd p{fd, POLLIN, 0};
+    int n = poll(&p, 1,
+                 std::chrono::ceil<std::chrono::milliseconds>(slice).count());
+    if (n > 0) return true;
+    if (n < 0 && errno != EINTR) return false;
+  }
+}
+
+void Supervisor::Impl::Reap(Worker& worker, bool kill) {
+  // Killing first ends a reload in progress on controlFd (EOF), so it is
+  // safe to wait for it before closing.
+  if (kill && worker.pid > 0) ::kill(worker.pid, SIGKILL);
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [&] { return !worker.reloading; });
+  }
+  if (worker.fd >= 0) close(worker.fd);
+  if (worker.controlFd >= 0) close(worker.controlFd);
+  if (worker.pid > 0) {
+    std::lock_guard<std::mutex> spawnLock(spawnMutex);
+    Message done;
+    if (!SendMessage(spawnerFd, kReap, kill ? 1 : 0, worker.pid) ||
+        !ReadAll(spawnerFd, &done, sizeof(done)))
+      *pLogger << "[ERROR] Could not reap worker " << worker.pid << "."
+               << std::endl;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  worker.fd = -1;
+  worker.controlFd = -1;
+  worker.pid = -1;
+}
+
+// Brings dead workers back, off the request path. A worker is claimed (busy)
+// while it is being spawned; failures back off exponentially.
+void Supervisor::Impl::RespawnLoop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!stopping) {
+    auto now = Clock::now();
+    auto next = Clock::time_point::max();
+    Worker* due = nullptr;
+    for (auto& w : workers) {
+      if (w.pid >= 0 || w.busy) continue;
+      if (w.respawnAt <= now) {
+        due = &w;
+        break;
+      }
+      next = std::min(next, w.respawnAt);
+    }
+    if (!due) {
+      if (next == Clock::time_point::max())
+        respawn.wait(lock);
+      else
+        respawn.wait_until(lock, next);
+      continue;
+    }
+
+    due->busy = true;
+    lock.unlock();
+    bool ok;
+    {
+      std::lock_guard<std::mutex> dictionaryLock(dictionaryMutex);
+      ok = Spawn(*due, userDic);
+    }
+    lock.lock();
+    due->busy = false;
+    if (ok) {
+      due->restarts++;
+      due->respawnDelay = kMinRespawnDelay;
+    } else {
+      due->respawnAt = Clock::now() + due->respawnDelay;
+      due->respawnDelay = std::min(due->respawnDelay * 2, kMaxRespawnDelay);
+    }
+    idle.notify_all();
+  }
+}
+
+// Returns false if the worker is gone. `ok` tells whether synthesis succeeded,
+// `delivered` whether the worker got the request at all.
+bool Supervisor::Impl::Exchange(Worker& worker, const char* text,
+                                long speakerId,
+                                const SynthesisOptions& options,
+                                std::vector<float>& wave, bool& ok,
+                                bool& delivered) {
+  size_t length = std::strlen(text);
+  delivered = false;
+  if (!SendMessage(worker.fd, kSynthesize, length, speakerId) ||
+      !WriteAll(worker.fd, text, length) ||
+      !WriteAll(worker.fd, &options, sizeof(options)))
+    return false;
+  delivered = true;
+
+  AudioRing* ring = worker.ring;
+  const uint64_t capacity = ring->capacity;
+  wave.clear();
+  Message m;
+  while (ReadAll(worker.fd, &m, sizeof(m))) {
+    switch (m.type) {
+      case kChunk: {
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        if (head - tail < m.size) return false;
+        size_t offset = wave.size();
+        size_t begin = tail % capacity;
+        size_t first = std::min<size_t>(m.size, capacity - begin);
+        wave.resize(offset + m.size);
+        std::memcpy(wave.data() + offset, ring->data() + begin,
+                    first * sizeof(float));
+        std::memcpy(wave.data() + offset + first, ring->data(),
+                    (m.size - first) * sizeof(float));
+        ring->tail.store(tail + m.size, std::memory_order_release);
+        if (!SendMessage(worker.fd, kAck)) return false;
+        break;
+      }
+      case kDone:
+        ok = true;
+        return true;
+      case kError:
+        ok = false;
+        return true;
+      default:
+        return false;
+    }
+  }
+  return false;
+}
+
+// Claims an idle, live worker. Returns nullptr if no worker is running; dead
+// workers are left to the respawner.
+Worker* Supervisor::Impl::Acquire() {
+  std::unique_lock<std::mutex> lock(mutex);
+  auto isIdle = [](const Worker& w) { return !w.busy && w.pid >= 0; };
+  auto isDown = [](const Worker& w) { return w.pid < 0; };
+  idle.wait(lock, [&] {
+    return std::any_of(workers.begin(), workers.end(), isIdle) ||
+           std::all_of(workers.begin(), workers.end(), isDown);
+  });
+  auto it = std::find_if(workers.begin(), workers.end(), isIdle);
+  if (it == workers.end()) return nullptr;
+  it->busy = true;
+  return &*it;
+}
+
+void Supervisor::Impl::Release(Worker& worker, Clock::duration elapsed,
+                               bool ok, size_t samples) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    worker.busy = false;
+    worker.busyTime += elapsed;
+    worker.requests++;
+    requests++;
+    if (ok)
+      audioSamples += samples;
+    else
+      worker.failures++;
+  }
+  idle.notify_all();
+}
+
+// Hands a worker that died (and has been reaped) to the respawner.
+void Supervisor::Impl::Retire(Worker& worker, Clock::duration elapsed) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    worker.busy = false;
+    worker.busyTime += elapsed;
+    worker.failures++;
+    worker.respawnAt = Clock::now();
+  }
+  idle.notify_all();
+  respawn.notify_all();
+}
+
+// Goes over the worker's control socket, so the worker keeps taking requests
+// while it loads. A worker that is down (or dies here) is left to the request
+// path and the respawner, which loads whatever dictionary is committed once
+// the reload finishes.
+ReloadResult Supervisor::Impl::Reload(Worker& worker,
+                                      const std::string& userDicPath) {
+  int fd;
+  pid_t pid;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (worker.pid < 0) return ReloadResult::kDown;
+    worker.reloading = true;
+    fd = worker.controlFd;
+    pid = worker.pid;
+  }
+  Message reply;
+  bool answered = SendMessage(fd, kReload, userDicPath.size()) &&
+                  WriteAll(fd, userDicPath.data(), userDicPath.size()) &&
+                  ReadAll(fd, &reply, sizeof(reply));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    worker.reloading = false;
+  }
+  idle.notify_all();
+  if (!answered) return ReloadResult::kDown;
+  if (reply.type != kDone) {
+    *pLogger << "[ERROR] Worker " << pid
+             << " failed to reload the user dictionary." << std::endl;
+    return ReloadResult::kRejected;
+  }
+  return ReloadResult::kReloaded;
+}
+
+Supervisor::Supervisor() : impl(new Impl) {}
+Supervisor::~Supervisor() { Stop(); }
+void Supervisor::SetLogger(const std::shared_ptr<std::ostream>& os) {
+  impl->pLogger = os;
+}
+
+bool Supervisor::Start(const SupervisorOptions& options) {
+  if (impl->started) {
+    *impl->pLogger << "Supervisor is already started. Skipping..."
+                   << std::endl;
+    return true;
+  }
+  if (options.numWorkers <= 0 || options.ringSamples == 0) {
+    *impl->pLogger << "[ERROR] Invalid supervisor options." << std::endl;
+    return false;
+  }
+  impl->options = options;
+  impl->stopping = false;
+  impl->workers.resize(options.numWorkers);
+  for (auto& worker : impl->workers) {
+    void* p = mmap(nullptr, AudioRing::Bytes(options.ringSamples),
+                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      *impl->pLogger << "[ERROR] Failed to map the audio ring." << std::endl;
+      Stop();
+      return false;
+    }
+    worker.ring = new (p) AudioRing;
+    worker.ring->capacity = options.ringSamples;
+  }
+  if (!impl->StartSpawner()) {
+    *impl->pLogger << "[ERROR] Failed to fork the spawner process."
+                   << std::endl;
+    Stop();
+    return false;
+  }
+  for (auto& worker : impl->workers) {
+    if (!impl->Spawn(worker, impl->userDic)) {
+      Stop();
+      return false;
+    }
+  }
+  impl->startTime = Clock::now();
+  impl->requests = 0;
+  impl->audioSamples = 0;
+  impl->respawner = std::thread([this] { impl->RespawnLoop(); });
+  impl->started = true;
+  *impl->pLogger << options.numWorkers << " workers started" << std::endl;
+  return true;
+}
+
+void Supervisor::Stop() {
+  if (impl->respawner.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(impl->mutex);
+      impl->stopping = true;
+    }
+    impl->respawn.notify_all();
+    impl->respawner.join();
+  }
+  for (auto& worker : impl->workers) {
+    impl->Reap(worker, false);
+    if (worker.ring)
+      munmap(worker.ring, AudioRing::Bytes(worker.ring->capacity));
+  }
+  impl->workers.clear();
+  if (impl->spawnerFd >= 0) {
+    close(impl->spawnerFd);
+    waitpid(impl->spawnerPid, nullptr, 0);
+    impl->spawnerFd = -1;
+    impl->spawnerPid = -1;
+  }
+  impl->started = false;
+}
+
+bool Supervisor::TextToSpeech(const char* textUtf8, long speakerId,
+                              std::vector<float>& wave,
+                              const SynthesisOptions& options) {
+  if (!impl->started) {
+    *impl->pLogger << "[ERROR] This supervisor is not started." << std::endl;
+    return false;
+  }
+
+  // A worker that dies goes to the respawner. The request is tried once more
+  // on another worker if the dead one never got it, or if the options allow
+  // retrying requests that may have caused the crash.
+  for (int attempt = 0; attempt < 2; attempt++) {
+    Worker* worker = impl->Acquire();
+    if (!worker) {
+      *impl->pLogger << "[ERROR] No worker is running." << std::endl;
+      return false;
+    }
+    auto begin = Clock::now();
+    bool ok = false, delivered = false;
+    if (impl->Exchange(*worker, textUtf8, speakerId, options, wave, ok,
+                       delivered)) {
+      impl->Release(*worker, Clock::now() - begin, ok, wave.size());
+      return ok;
+    }
+    *impl->pLogger << "[ERROR] Worker " << worker->pid
+                   << " died. Restarting..." << std::endl;
+    impl->Reap(*worker, true);
+    impl->Retire(*worker, Clock::now() - begin);
+    if (delivered && !impl->options.retryCrashedRequests) break;
+  }
+  *impl->pLogger << "[ERROR] Giving up on this request." << std::endl;
+  return false;
+}
+
+bool Supervisor::ReloadUserDictionary(const char* userDicPath) {
+  if (!impl->started) {
+    *impl->pLogger << "[ERROR] This supervisor is not started." << std::endl;
+    return false;
+  }
+  std::lock_guard<std::mutex> dictionaryLock(impl->dictionaryMutex);
+  std::string path = userDicPath ? userDicPath : "";
+
+  // One worker at a time, to bound the extra memory of a second dictionary.
+  // Workers keep serving throughout. The new dictionary is only kept once
+  // every live worker has accepted it; otherwise the workers that did are
+  // switched back.
+  std::vector<Worker*> reloaded;
+  bool ok = true;
+  for (auto& worker : impl->workers) {
+    ReloadResult result = impl->Reload(worker, path);
+    if (result == ReloadResult::kReloaded) reloaded.push_back(&worker);
+    if (result == ReloadResult::kRejected) {
+      ok = false;
+      break;
+    }
+  }
+  if (ok) {
+    impl->userDic = path;
+    *impl->pLogger << "user dictionary reloaded" << std::endl;
+    return true;
+  }
+  for (Worker* worker : reloaded) {
+    if (impl->Reload(*worker, impl->userDic) == ReloadResult::kRejected)
+      *impl->pLogger << "[ERROR] Worker " << worker->pid
+                     << " could not restore the previous user dictionary."
+                     << std::endl;
+  }
+  return false;
+}
+
+SupervisorStats Supervisor::Stats() const {
+  std::lock_guard<std::mutex> lock(impl->mutex);
+  using Seconds = std::chrono::duration<double>;
+  SupervisorStats stats{};
+  if (!impl->started) return stats;
+
+  stats.uptimeSeconds = Seconds(Clock::now() - impl->startTime).count();
+  stats.requests = impl->requests;
+  stats.audioSeconds = (double)impl->audioSamples / kSamplingRate;
+  if (stats.uptimeSeconds > 0) {
+    stats.requestsPerSecond = stats.requests / stats.uptimeSeconds;
+    stats.realtimeFactor = stats.audioSeconds / stats.uptimeSeconds;
+  }
+  for (const auto& w : impl->workers) {
+    WorkerStats ws{};
+    ws.pid = w.pid;
+    ws.requests = w.requests;
+    ws.failures = w.failures;
+    ws.restarts = w.restarts;
+    ws.busySeconds = Seconds(w.busyTime).count();
+    if (stats.uptimeSeconds > 0)
+      ws.utilization = ws.busySeconds / stats.uptimeSeconds;
+    stats.workers.push_back(ws);
+  }
+  return stats;
+}
+
+void Supervisor::ReportStats(std::ostream& os) const {
+  auto stats = Stats();
+  os << "uptime " << stats.uptimeSeconds << " s, " << stats.requests
+     << " requests (" << stats.requestsPerSecond << " req/s), "
+     << stats.audioSeconds << " s audio (x" << stats.realtimeFactor
+     << " realtime)" << std::endl;
+  for (size_t i = 0; i < stats.workers.size(); i++) {
+    const auto& w = stats.workers[i];
+    os << "  worker " << i << " pid " << w.pid << ": " << w.requests
+       << " requests, " << w.failures << " failures, " << w.restarts
+       << " restarts, utilization " << w.utilization * 100 << "%"
+       << std::endl;
+  }
+}
+
+}  // namespace vvengine
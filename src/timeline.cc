@@ -0,0 +1,96 @@
+#include "vvengine/timeline.h"
+
+#include <algorithm>
+#include <map>
+
+namespace vvengine {
+Viseme VisemeFromPhoneme(const std::string& phoneme) {
+  static const std::map<std::string, Viseme> visemeMap = {
+      {"pau", Viseme::kSilence}, {"sil", Viseme::kSilence},
+      {"cl", Viseme::kSilence},  {"a", Viseme::kA},
+      {"A", Viseme::kA},         {"i", Viseme::kI},
+      {"I", Viseme::kI},         {"u", Viseme::kU},
+      {"U", Viseme::kU},         {"w", Viseme::kU},
+      {"e", Viseme::kE},         {"E", Viseme::kE},
+      {"o", Viseme::kO},         {"O", Viseme::kO},
+      {"N", Viseme::kClosed},    {"m", Viseme::kClosed},
+      {"my", Viseme::kClosed},   {"b", Viseme::kClosed},
+      {"by", Viseme::kClosed},   {"p", Viseme::kClosed},
+      {"py", Viseme::kClosed},   {"f", Viseme::kLabiodental},
+      {"v", Viseme::kLabiodental}};
+  auto it = visemeMap.find(phoneme);
+  return it != visemeMap.end() ? it->second : Viseme::kConsonant;
+}
+
+const char* VisemeName(Viseme viseme) {
+  switch (viseme) {
+    case Viseme::kSilence:
+      return "sil";
+    case Viseme::kA:
+      return "a";
+    case Viseme::kI:
+      return "i";
+    case Viseme::kU:
+      return "u";
+    case Viseme::kE:
+      return "e";
+    case Viseme::kO:
+      return "o";
+    case Viseme::kClosed:
+      return "closed";
+    case Viseme::kLabiodental:
+      return "labiodental";
+    case Viseme::kConsonant:
+      return "consonant";
+  }
+  return "";
+}
+
+Timeline Timeline::FromDurations(const Utterance& utterance,
+                                 const std::vector<std::string>& phonemes,
+                                 const std::vector<long>& phonemeSamples) {
+  Timeline timeline;
+  long t = 0;
+  for (size_t i = 0; i < phonemes.size(); i++) {
+    timeline.phonemes.push_back(PhonemeEvent{
+        phonemes[i], VisemeFromPhoneme(phonemes[i]), t, t + phonemeSamples[i]});
+    t += phonemeSamples[i];
+  }
+
+  // Same walk as Utterance::phonemes(): a pause precedes every breath group.
+  const auto& events = timeline.phonemes;
+  size_t index = 0;
+  for (size_t i = 0; i < utterance.pauses.size(); i++) {
+    index++;
+    if (i + 1 >= utterance.pauses.size() ||
+        i >= utterance.breathGroups.size())
+      break;
+    for (const auto& accentPhrase : utterance.breathGroups[i].accentPhrases) {
+      size_t moraBegin = timeline.moras.size();
+      for (const auto& mora : accentPhrase.moras) {
+        size_t next = index + (mora.consonant ? 2 : 1);
+        if (next > events.size()) return timeline;
+        timeline.moras.push_back(MoraEvent{index, next, events[index].start,
+                                           events[next - 1].end});
+        index = next;
+      }
+      if (moraBegin == timeline.moras.size()) continue;
+      timeline.accentPhrases.push_back(AccentPhraseEvent{
+          moraBegin, timeline.moras.size(), accentPhrase.accent,
+          timeline.moras[moraBegin].start, timeline.moras.back().end});
+    }
+  }
+  return timeline;
+}
+
+void Timeline::Shift(long shift, long length) {
+  auto move = [&](long& start, long& end) {
+    start = std::min(std::max(start + shift, 0L), length);
+    end = std::min(std::max(end + shift, 0L), length);
+  };
+  for (auto& e : phonemes) move(e.start, e.end);
+  for (auto& e : moras) move(e.start, e.end);
+  for (auto& e : accentPhrases) move(e.start, e.end);
+}
+
+}  // namespace vvengine
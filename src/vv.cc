@@ -24,7 +24,7 @@ int main() {
   std::vector<float> wave;
   engine.TextToSpeech(inputText, 0, wave);
 
-  vvengine::WriteWAV("out.wav", wave, 24000);
+  vvengine::WriteWAV("out.wav", wave, vvengine::kSamplingRate);
   log->close();
   return 0;
 }
\ No newline at end of file
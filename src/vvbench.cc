@@ -0,0 +1,98 @@
+// Latency of prosody edits: full synthesis (Analyze + Synthesize) against the
+// fast path that reuses the AudioQuery and only reruns Synthesize.
+//   vvbench [text] [iterations]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "vvengine/engine.h"
+
+#ifdef USE_CUDA
+#undef USE_CUDA
+#define USE_CUDA true
+#else
+#define USE_CUDA false
+#endif
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+template <typename F>
+double MeanMilliseconds(int iterations, F f) {
+  auto begin = Clock::now();
+  for (int i = 0; i < iterations; i++) f();
+  std::chrono::duration<double, std::milli> elapsed = Clock::now() - begin;
+  return elapsed.count() / iterations;
+}
+
+struct Adjustment {
+  const char* name;
+  vvengine::SynthesisOptions options;
+};
+
+std::vector<Adjustment> Adjustments() {
+  std::vector<Adjustment> adjustments(6);
+  adjustments[0].name = "none";
+  adjustments[1].name = "speed x1.3";
+  adjustments[1].options.speedScale = 1.3f;
+  adjustments[2].name = "pitch +0.1";
+  adjustments[2].options.pitchScale = 0.1f;
+  adjustments[3].name = "intonation x1.5";
+  adjustments[3].options.intonationScale = 1.5f;
+  adjustments[4].name = "pre/post 0.3 s";
+  adjustments[4].options.prePhonemeLength = 0.3f;
+  adjustments[4].options.postPhonemeLength = 0.3f;
+  adjustments[5].name = "all";
+  adjustments[5].options.speedScale = 1.3f;
+  adjustments[5].options.pitchScale = 0.1f;
+  adjustments[5].options.intonationScale = 1.5f;
+  adjustments[5].options.prePhonemeLength = 0.3f;
+  adjustments[5].options.postPhonemeLength = 0.3f;
+  return adjustments;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* inputText = argc > 1 ? argv[1] : u8"ハローワールド";
+  int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+
+  vvengine::Engine engine;
+  if (!engine.Initialize(USE_CUDA)) return 1;
+
+  vvengine::AudioQuery query;
+  std::vector<float> wave;
+  // warm up
+  if (!engine.Analyze(inputText, 0, query) || !engine.Synthesize(query, wave))
+    return 1;
+
+  double analyze = MeanMilliseconds(iterations, [&] {
+    vvengine::AudioQuery q;
+    engine.Analyze(inputText, 0, q);
+  });
+  std::cout << "analyze only: " << std::fixed << std::setprecision(2)
+            << analyze << " ms (" << iterations << " iterations)"
+            << std::endl;
+  std::cout << std::left << std::setw(18) << "adjustment" << std::right
+            << std::setw(12) << "full ms" << std::setw(12) << "fast ms"
+            << std::setw(12) << "saved ms" << std::setw(10) << "saved"
+            << std::endl;
+  for (const auto& adjustment : Adjustments()) {
+    double full = MeanMilliseconds(iterations, [&] {
+      vvengine::AudioQuery q;
+      engine.Analyze(inputText, 0, q);
+      engine.Synthesize(q, wave, adjustment.options);
+    });
+    double fast = MeanMilliseconds(iterations, [&] {
+      engine.Synthesize(query, wave, adjustment.options);
+    });
+    std::cout << std::left << std::setw(18) << adjustment.name << std::right
+              << std::setw(12) << full << std::setw(12) << fast
+              << std::setw(12) << full - fast << std::setw(9)
+              << (full > 0 ? (full - fast) / full * 100 : 0) << "%"
+              << std::endl;
+  }
+  return 0;
+}